@@ -32,12 +32,36 @@ void encode_ppm_p3(
          << width << ' ' << height << endl
          << 255 << endl;
 
+    // Format the samples into a fixed chunk and write it whenever it fills,
+    // rather than going through the stream (and a flush) per pixel
+    const size_t PIXEL_TEXT_MAX = 12;
+    std::vector<char> chunk(256 * 1024);
+    size_t used = 0;
+    auto append_channel = [&chunk, &used](uint8_t value, char separator)
+    {
+        if (value >= 100)
+        {
+            chunk[used++] = static_cast<char>('0' + value / 100);
+        }
+        if (value >= 10)
+        {
+            chunk[used++] = static_cast<char>('0' + value / 10 % 10);
+        }
+        chunk[used++] = static_cast<char>('0' + value % 10);
+        chunk[used++] = separator;
+    };
     for (const auto &color : colors)
     {
-        file.operator<<(color.r()) << ' ';
-        file.operator<<(color.g()) << ' ';
-        file.operator<<(color.b()) << endl;
+        if (used + PIXEL_TEXT_MAX > chunk.size())
+        {
+            file.write(chunk.data(), static_cast<std::streamsize>(used));
+            used = 0;
+        }
+        append_channel(color.r(), ' ');
+        append_channel(color.g(), ' ');
+        append_channel(color.b(), '\n');
     }
+    file.write(chunk.data(), static_cast<std::streamsize>(used));
 }
 
 vec3<uint8_t> convert_vec3_float_to_uint8_once(
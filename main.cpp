@@ -6,16 +6,23 @@
 #include <algorithm>
 #include <functional>
 #include <random>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
 
 #include "io.hpp"
 #include "ray3.hpp"
+#include "render.hpp"
 #include "vec3.hpp"
 
 const uint32_t WIDTH = 800;
 const uint32_t HEIGHT = 400;
 const float ASPECT_RATIO = static_cast<float>(WIDTH) / static_cast<float>(HEIGHT);
 const int SAMPLES_PER_PIXEL = 100;
+const uint32_t TILE_SIZE = 16;
 const int SEED = 42;
+const float EXPOSURE = 1.0f;
+const bool SRGB_OUTPUT = false;
 
 struct Material
 {
@@ -100,6 +107,94 @@ bool find_nearest_hit(const ray3<float> &r, const std::vector<Sphere> &world, fl
     return hit_anything;
 }
 
+// Conservative bounds of a sphere's projection on the image plane, along one
+// viewport axis. `lateral` is the center offset along that axis and `depth` the
+// distance in front of the camera. Returns false when the sphere reaches
+// behind the camera, in which case its projection is unbounded.
+bool project_sphere_extent(float lateral, float depth, float radius, float focal_length, float &lo, float &hi)
+{
+    float denom = depth * depth - radius * radius;
+    if (depth <= radius || denom <= 0.0f)
+    {
+        return false;
+    }
+    float spread = radius * std::sqrt(lateral * lateral + denom);
+    lo = (lateral * depth - spread) / denom * focal_length;
+    hi = (lateral * depth + spread) / denom * focal_length;
+    return true;
+}
+
+// Per-tile candidate lists for primary rays. Each tile keeps, in world order,
+// the spheres whose projection may overlap it, so a camera ray only needs to
+// test its own tile's list. Assumes the camera looks down -z through an
+// axis-aligned viewport, as in render_scene.
+struct TileBins
+{
+    uint32_t tiles_x;
+    uint32_t tiles_y;
+    std::vector<std::vector<Sphere>> bins;
+
+    inline const std::vector<Sphere> &at(uint32_t i, uint32_t j) const
+    {
+        return bins[(j / TILE_SIZE) * tiles_x + i / TILE_SIZE];
+    }
+};
+
+TileBins bin_spheres_to_tiles(
+    const std::vector<Sphere> &world,
+    const vec3<float> &cam_origin,
+    const vec3<float> &lower_left_corner,
+    const vec3<float> &horizontal,
+    const vec3<float> &vertical,
+    float focal_length)
+{
+    TileBins tiles;
+    tiles.tiles_x = (WIDTH + TILE_SIZE - 1) / TILE_SIZE;
+    tiles.tiles_y = (HEIGHT + TILE_SIZE - 1) / TILE_SIZE;
+    tiles.bins.resize(tiles.tiles_x * tiles.tiles_y);
+
+    vec3<float> corner = lower_left_corner - cam_origin;
+    for (const auto &sphere_obj : world)
+    {
+        vec3<float> center = sphere_obj.center - cam_origin;
+        float depth = -center.z();
+
+        // Pixel rectangle covered, padded by one pixel to absorb rounding
+        int64_t i_min = 0, i_max = WIDTH - 1;
+        int64_t j_min = 0, j_max = HEIGHT - 1;
+        float x_lo, x_hi, y_lo, y_hi;
+        if (project_sphere_extent(center.x(), depth, sphere_obj.radius, focal_length, x_lo, x_hi) &&
+            project_sphere_extent(center.y(), depth, sphere_obj.radius, focal_length, y_lo, y_hi))
+        {
+            float u_lo = (x_lo - corner.x()) / horizontal.x() * (WIDTH - 1);
+            float u_hi = (x_hi - corner.x()) / horizontal.x() * (WIDTH - 1);
+            float v_lo = (y_lo - corner.y()) / vertical.y() * (HEIGHT - 1);
+            float v_hi = (y_hi - corner.y()) / vertical.y() * (HEIGHT - 1);
+            if (u_hi < -1.0f || u_lo > WIDTH || v_hi < -1.0f || v_lo > HEIGHT)
+            {
+                continue;
+            }
+            u_lo = std::max(u_lo, -1.0f);
+            u_hi = std::min(u_hi, static_cast<float>(WIDTH));
+            v_lo = std::max(v_lo, -1.0f);
+            v_hi = std::min(v_hi, static_cast<float>(HEIGHT));
+            i_min = std::max<int64_t>(0, static_cast<int64_t>(std::floor(u_lo)) - 1);
+            i_max = std::min<int64_t>(WIDTH - 1, static_cast<int64_t>(std::floor(u_hi)) + 1);
+            j_min = std::max<int64_t>(0, HEIGHT - 1 - (static_cast<int64_t>(std::floor(v_hi)) + 1));
+            j_max = std::min<int64_t>(HEIGHT - 1, HEIGHT - 1 - (static_cast<int64_t>(std::floor(v_lo)) - 1));
+        }
+
+        for (int64_t ty = j_min / TILE_SIZE; ty <= j_max / TILE_SIZE; ++ty)
+        {
+            for (int64_t tx = i_min / TILE_SIZE; tx <= i_max / TILE_SIZE; ++tx)
+            {
+                tiles.bins[ty * tiles.tiles_x + tx].push_back(sphere_obj);
+            }
+        }
+    }
+    return tiles;
+}
+
 vec3<float> color_for_ray_multisphere(const ray3<float> &r, const std::vector<Sphere> &world)
 {
     HitRecord rec;
@@ -122,10 +217,10 @@ struct PointLight
     float att_q = 0.0f;
 };
 
-vec3<float> color_for_ray_shadows(const ray3<float> &r, const std::vector<Sphere> &world, const std::vector<PointLight> &lights)
+vec3<float> color_for_ray_shadows(const ray3<float> &r, const std::vector<Sphere> &candidates, const std::vector<Sphere> &world, const std::vector<PointLight> &lights)
 {
     HitRecord rec;
-    if (find_nearest_hit(r, world, 0.001f, std::numeric_limits<float>::infinity(), rec))
+    if (find_nearest_hit(r, candidates, 0.001f, std::numeric_limits<float>::infinity(), rec))
     {
         vec3<float> final_color(0.0f, 0.0f, 0.0f);
         vec3<float> ambient_color = rec.material.albedo * 0.1f;
@@ -199,11 +294,11 @@ float schlick_reflectance(float cosine, float ref_idx_ratio)
 const int MAX_RECURSION_DEPTH = 5;
 const float SHADOW_RAY_T_MIN = 0.001f;
 
-vec3<float> color_for_ray_recursive(const ray3<float> &r, const std::vector<Sphere> &world, const std::vector<PointLight> &lights, int depth);
+vec3<float> color_for_ray_recursive(const ray3<float> &r, const std::vector<Sphere> &candidates, const std::vector<Sphere> &world, const std::vector<PointLight> &lights, int depth);
 
 // Removed get_shadow_attenuation as it's no longer used.
 
-vec3<float> color_for_ray_recursive(const ray3<float> &r, const std::vector<Sphere> &world, const std::vector<PointLight> &lights, int depth)
+vec3<float> color_for_ray_recursive(const ray3<float> &r, const std::vector<Sphere> &candidates, const std::vector<Sphere> &world, const std::vector<PointLight> &lights, int depth)
 {
     if (depth <= 0)
     {
@@ -211,7 +306,7 @@ vec3<float> color_for_ray_recursive(const ray3<float> &r, const std::vector<Sphe
     }
 
     HitRecord rec;
-    if (find_nearest_hit(r, world, SHADOW_RAY_T_MIN, std::numeric_limits<float>::infinity(), rec))
+    if (find_nearest_hit(r, candidates, SHADOW_RAY_T_MIN, std::numeric_limits<float>::infinity(), rec))
     {
         vec3<float> emitted_color(0.0f, 0.0f, 0.0f);
         vec3<float> scattered_color(0.0f, 0.0f, 0.0f);
@@ -245,13 +340,13 @@ vec3<float> color_for_ray_recursive(const ray3<float> &r, const std::vector<Sphe
 
             vec3<float> reflected_dir = reflect(unit_incident_dir, surface_normal);
             ray3<float> reflected_ray(rec.point + surface_normal * SHADOW_RAY_T_MIN, reflected_dir.normalized());
-            reflection_color = color_for_ray_recursive(reflected_ray, world, lights, depth - 1);
+            reflection_color = color_for_ray_recursive(reflected_ray, world, world, lights, depth - 1);
 
             vec3<float> refracted_dir;
             if (refract(unit_incident_dir, surface_normal, n_ratio, refracted_dir))
             {
                 ray3<float> refracted_ray(rec.point - surface_normal * SHADOW_RAY_T_MIN, refracted_dir.normalized());
-                refraction_color = color_for_ray_recursive(refracted_ray, world, lights, depth - 1);
+                refraction_color = color_for_ray_recursive(refracted_ray, world, world, lights, depth - 1);
             }
             else
             {
@@ -304,7 +399,7 @@ vec3<float> color_for_ray_recursive(const ray3<float> &r, const std::vector<Sphe
             {
                 vec3<float> reflection_ray_dir = reflect(r.direction().normalized(), rec.normal);
                 ray3<float> reflection_ray(rec.point + rec.normal * SHADOW_RAY_T_MIN, reflection_ray_dir);
-                reflected_contribution = color_for_ray_recursive(reflection_ray, world, lights, depth - 1) * rec.material.reflectivity;
+                reflected_contribution = color_for_ray_recursive(reflection_ray, world, world, lights, depth - 1) * rec.material.reflectivity;
             }
             scattered_color = local_illumination * (1.0f - rec.material.reflectivity) + reflected_contribution;
             return (emitted_color + scattered_color).clamp(0.0f, 1.0f);
@@ -316,15 +411,49 @@ vec3<float> color_for_ray_recursive(const ray3<float> &r, const std::vector<Sphe
     return vec3<float>(1.0f - t_bg) * vec3<float>(1.0f, 1.0f, 1.0f) + t_bg * vec3<float>(0.5f, 0.7f, 1.0f);
 }
 
-vec3<float> trace_ray(const ray3<float> &r, const std::vector<Sphere> &world, const std::vector<PointLight> &lights, int depth)
+vec3<float> trace_ray(const ray3<float> &r, const std::vector<Sphere> &candidates, const std::vector<Sphere> &world, const std::vector<PointLight> &lights, int depth)
 {
-    return color_for_ray_recursive(r, world, lights, depth);
+    return color_for_ray_recursive(r, candidates, world, lights, depth);
 }
 
-void render_scene(
+// Normalizes, exposes and quantizes the accumulated samples in one parallel
+// sweep, then writes the result as PPM.
+template <typename Normalizer>
+void write_framebuffer(
+    const std::string &output_filename,
+    const std::vector<vec3<float>> &colors_accumulated,
+    const Normalizer &normalize)
+{
+    std::vector<vec3<uint8_t>> colors_quantized;
+    if (SRGB_OUTPUT)
+    {
+        post_process(WIDTH, colors_accumulated, colors_quantized, quantize_srgb(), normalize, expose{EXPOSURE});
+    }
+    else
+    {
+        post_process(WIDTH, colors_accumulated, colors_quantized, quantize_linear(), normalize, expose{EXPOSURE});
+    }
+    encode_ppm_p3(WIDTH, HEIGHT, colors_quantized, output_filename);
+}
+
+inline float luminance(const vec3<float> &color)
+{
+    return color.dot(vec3<float>(0.2126f, 0.7152f, 0.0722f));
+}
+
+// Traces the frame and writes it out. With a zero `time_budget` every pixel
+// takes SAMPLES_PER_PIXEL samples. Otherwise the frame is refined in passes
+// that each add the same number of samples to every pixel, sized from the
+// throughput measured so far, until the budget runs out. The first pass
+// always completes so that every pixel has at least one sample.
+// `sample_func(ray, candidates)` shades one camera ray against its tile's
+// candidate spheres.
+template <typename SampleFunc>
+void render_frame(
     const std::string &output_filename,
     const std::vector<Sphere> &world,
-    const std::function<vec3<float>(const ray3<float> &, const std::vector<Sphere> &)> &color_func)
+    const SampleFunc &sample_func,
+    std::chrono::duration<double> time_budget)
 {
     using namespace std;
     vector<vec3<float>> colors_float(WIDTH * HEIGHT);
@@ -339,76 +468,186 @@ void render_scene(
     vec3<float> horizontal(viewport_width, 0.0f, 0.0f);
     vec3<float> vertical(0.0f, viewport_height, 0.0f);
     vec3<float> lower_left_corner = cam_origin - horizontal / 2.0f - vertical / 2.0f - vec3<float>(0.0f, 0.0f, focal_length);
+    TileBins tiles = bin_spheres_to_tiles(world, cam_origin, lower_left_corner, horizontal, vertical, focal_length);
 
-    for (uint32_t j = 0; j < HEIGHT; ++j)
+    auto sample_pixel = [&](uint32_t i, uint32_t j)
     {
-        for (uint32_t i = 0; i < WIDTH; ++i)
+        float u_sample = (static_cast<float>(i) + distrib(gen)) / (WIDTH - 1);
+        float v_sample = (static_cast<float>(HEIGHT - 1 - j) + distrib(gen)) / (HEIGHT - 1);
+
+        vec3<float> ray_target_on_viewport = lower_left_corner + u_sample * horizontal + v_sample * vertical;
+        ray3<float> r_sample(cam_origin, ray_target_on_viewport - cam_origin);
+        return sample_func(r_sample, tiles.at(i, j));
+    };
+
+    if (time_budget <= chrono::duration<double>::zero())
+    {
+        for (uint32_t j = 0; j < HEIGHT; ++j)
         {
-            vec3<float> pixel_color(0.0f, 0.0f, 0.0f);
-            for (int s = 0; s < SAMPLES_PER_PIXEL; ++s)
+            for (uint32_t i = 0; i < WIDTH; ++i)
             {
-                float u_sample = (static_cast<float>(i) + distrib(gen)) / (WIDTH - 1);
-                float v_sample = (static_cast<float>(HEIGHT - 1 - j) + distrib(gen)) / (HEIGHT - 1);
-
-                vec3<float> ray_target_on_viewport = lower_left_corner + u_sample * horizontal + v_sample * vertical;
-                ray3<float> r_sample(cam_origin, ray_target_on_viewport - cam_origin);
-                pixel_color += color_func(r_sample, world);
+                vec3<float> pixel_color(0.0f, 0.0f, 0.0f);
+                for (int s = 0; s < SAMPLES_PER_PIXEL; ++s)
+                {
+                    pixel_color += sample_pixel(i, j);
+                }
+                colors_float[j * WIDTH + i] = pixel_color;
             }
-            colors_float[j * WIDTH + i] = pixel_color / static_cast<float>(SAMPLES_PER_PIXEL);
         }
+
+        write_framebuffer(output_filename, colors_float, normalize_samples{static_cast<float>(SAMPLES_PER_PIXEL)});
+        return;
     }
 
-    vector<vec3<uint8_t>> colors_quantized = convert_vec3_float_to_uint8_many(colors_float, 0.0f, 1.0f);
-    encode_ppm_p3(WIDTH, HEIGHT, colors_quantized, output_filename);
-}
+    // Per-pixel sample counts and sums of squared luminance, for the
+    // normalization and the noise estimate
+    vector<uint32_t> sample_counts(WIDTH * HEIGHT, 0);
+    vector<float> luminance_sq(WIDTH * HEIGHT, 0.0f);
+    const uint64_t pixel_count = static_cast<uint64_t>(WIDTH) * HEIGHT;
+    uint64_t total_samples = 0;
+    uint32_t pass_samples = 1;
+
+    // Visit rows in bit-reversed order, so a pass cut short by the deadline
+    // still spreads its samples evenly down the image
+    vector<uint32_t> row_order;
+    row_order.reserve(HEIGHT);
+    uint32_t row_bits = 0;
+    while ((1u << row_bits) < HEIGHT)
+    {
+        ++row_bits;
+    }
+    for (uint32_t k = 0; k < (1u << row_bits); ++k)
+    {
+        uint32_t row = 0;
+        for (uint32_t b = 0; b < row_bits; ++b)
+        {
+            row |= ((k >> b) & 1u) << (row_bits - 1 - b);
+        }
+        if (row < HEIGHT)
+        {
+            row_order.push_back(row);
+        }
+    }
 
-void render_scene(
-    const std::string &output_filename,
-    const std::vector<Sphere> &world,
-    const std::vector<PointLight> &lights,
-    const std::function<vec3<float>(const ray3<float> &, const std::vector<Sphere> &, const std::vector<PointLight> &, int)> &color_func_recursive)
-{
-    using namespace std;
-    vector<vec3<float>> colors_float(WIDTH * HEIGHT);
-    std::mt19937 gen(SEED);
-    std::uniform_real_distribution<float> distrib(0.0f, 1.0f);
+    const auto start = chrono::steady_clock::now();
+    chrono::duration<double> elapsed(0.0);
+    bool out_of_time = false;
+    while (!out_of_time)
+    {
+        for (uint32_t row = 0; row < HEIGHT && !out_of_time; ++row)
+        {
+            const uint32_t j = row_order[row];
+            for (uint32_t i = 0; i < WIDTH; ++i)
+            {
+                const uint32_t index = j * WIDTH + i;
+                for (uint32_t s = 0; s < pass_samples; ++s)
+                {
+                    vec3<float> color = sample_pixel(i, j);
+                    float l = luminance(color);
+                    colors_float[index] += color;
+                    luminance_sq[index] += l * l;
+                }
+                sample_counts[index] += pass_samples;
+            }
+            total_samples += static_cast<uint64_t>(pass_samples) * WIDTH;
 
-    auto viewport_height = 2.0f;
-    auto viewport_width = ASPECT_RATIO * viewport_height;
-    auto focal_length = 1.0f;
+            // Stopping at a row boundary keeps every pixel normalized by its
+            // own count, so only the first pass has to finish
+            elapsed = chrono::steady_clock::now() - start;
+            out_of_time = total_samples >= pixel_count && elapsed >= time_budget;
+        }
 
-    vec3<float> cam_origin(0.0f, 0.0f, 0.0f);
-    vec3<float> horizontal(viewport_width, 0.0f, 0.0f);
-    vec3<float> vertical(0.0f, viewport_height, 0.0f);
-    vec3<float> lower_left_corner = cam_origin - horizontal / 2.0f - vertical / 2.0f - vec3<float>(0.0f, 0.0f, focal_length);
+        // Aim each further pass at a quarter of the remaining budget
+        double samples_per_second = static_cast<double>(total_samples) / std::max(elapsed.count(), 1e-6);
+        double affordable_samples = samples_per_second * (time_budget - elapsed).count();
+        pass_samples = static_cast<uint32_t>(std::clamp(affordable_samples / pixel_count / 4.0, 1.0, 1024.0));
+    }
 
-    for (uint32_t j = 0; j < HEIGHT; ++j)
+    // RMS over pixels of the standard error of the mean pixel luminance. Only
+    // pixels with two or more samples have a variance, so the coverage is
+    // reported along with it
+    double noise_sq = 0.0;
+    uint64_t noise_pixels = 0;
+    for (uint32_t index = 0; index < WIDTH * HEIGHT; ++index)
     {
-        for (uint32_t i = 0; i < WIDTH; ++i)
+        const uint32_t n = sample_counts[index];
+        if (n < 2)
         {
-            vec3<float> pixel_color(0.0f, 0.0f, 0.0f);
-            for (int s = 0; s < SAMPLES_PER_PIXEL; ++s)
-            {
-                float u_sample = (static_cast<float>(i) + distrib(gen)) / (WIDTH - 1);
-                float v_sample = (static_cast<float>(HEIGHT - 1 - j) + distrib(gen)) / (HEIGHT - 1);
+            continue;
+        }
+        double mean = luminance(colors_float[index]) / n;
+        double variance = std::max(0.0, (luminance_sq[index] / n - mean * mean) * n / (n - 1));
+        noise_sq += variance / n;
+        ++noise_pixels;
+    }
 
-                vec3<float> ray_target_on_viewport = lower_left_corner + u_sample * horizontal + v_sample * vertical;
-                ray3<float> r_sample(cam_origin, ray_target_on_viewport - cam_origin);
-                pixel_color += color_func_recursive(r_sample, world, lights, MAX_RECURSION_DEPTH);
-            }
-            colors_float[j * WIDTH + i] = pixel_color / static_cast<float>(SAMPLES_PER_PIXEL);
+    write_framebuffer(output_filename, colors_float, normalize_sample_counts{sample_counts});
+
+    std::cout << "[Render] " << output_filename << ": "
+              << static_cast<double>(total_samples) / pixel_count << " spp, noise ";
+    if (noise_pixels)
+    {
+        std::cout << std::sqrt(noise_sq / noise_pixels);
+        if (noise_pixels < pixel_count)
+        {
+            std::cout << " over " << noise_pixels << " of " << pixel_count << " pixels";
         }
     }
+    else
+    {
+        std::cout << "n/a";
+    }
+    std::cout << " in " << elapsed.count() << " s ("
+              << static_cast<double>(total_samples) / elapsed.count() << " samples/s)" << std::endl;
+}
 
-    vector<vec3<uint8_t>> colors_quantized = convert_vec3_float_to_uint8_many(colors_float, 0.0f, 1.0f);
-    encode_ppm_p3(WIDTH, HEIGHT, colors_quantized, output_filename);
+void render_scene(
+    const std::string &output_filename,
+    const std::vector<Sphere> &world,
+    const std::function<vec3<float>(const ray3<float> &, const std::vector<Sphere> &, const std::vector<Sphere> &)> &color_func,
+    std::chrono::duration<double> time_budget = {})
+{
+    auto sample_func = [&](const ray3<float> &r_sample, const std::vector<Sphere> &candidates)
+    {
+        return color_func(r_sample, candidates, world);
+    };
+    render_frame(output_filename, world, sample_func, time_budget);
 }
 
-int main()
+void render_scene(
+    const std::string &output_filename,
+    const std::vector<Sphere> &world,
+    const std::vector<PointLight> &lights,
+    const std::function<vec3<float>(const ray3<float> &, const std::vector<Sphere> &, const std::vector<Sphere> &, const std::vector<PointLight> &, int)> &color_func_recursive,
+    std::chrono::duration<double> time_budget = {})
+{
+    auto sample_func = [&](const ray3<float> &r_sample, const std::vector<Sphere> &candidates)
+    {
+        return color_func_recursive(r_sample, candidates, world, lights, MAX_RECURSION_DEPTH);
+    };
+    render_frame(output_filename, world, sample_func, time_budget);
+}
+
+int main(int argc, char *argv[])
 {
     using namespace std;
     namespace fs = std::filesystem;
 
+    // An optional per-image time budget in seconds switches to deadline mode;
+    // an explicit 0 keeps the fixed sample count
+    chrono::duration<double> time_budget(0.0);
+    if (argc > 1)
+    {
+        char *end = nullptr;
+        double seconds = std::strtod(argv[1], &end);
+        if (end == argv[1] || *end != '\0' || !std::isfinite(seconds) || seconds < 0.0)
+        {
+            std::cerr << "[Args Error] Invalid time budget in seconds: " << argv[1] << std::endl;
+            return 1;
+        }
+        time_budget = chrono::duration<double>(seconds);
+    }
+
     if (!fs::exists("outputs"))
     {
         fs::create_directory("outputs");
@@ -428,22 +667,22 @@ int main()
     world_spheres.push_back({{0.0f, -0.15f, -0.3f}, 0.1f, {{0.5f, 0.9f, 0.5f}}});
 
     auto multisphere_adapter =
-        [&](const ray3<float> &r_in, const std::vector<Sphere> &w_in)
+        [&](const ray3<float> &r_in, const std::vector<Sphere> &c_in, const std::vector<Sphere> &)
     {
-        return color_for_ray_multisphere(r_in, w_in);
+        return color_for_ray_multisphere(r_in, c_in);
     };
-    render_scene("outputs/1_multisphere.ppm", world_spheres, multisphere_adapter);
+    render_scene("outputs/1_multisphere.ppm", world_spheres, multisphere_adapter, time_budget);
 
     std::vector<PointLight> lights;
     lights.push_back({{-5.0f, 5.0f, -0.5f}, {1.5f, 1.5f, 1.5f}, 1.0f, 0.09f, 0.032f});
     lights.push_back({{5.0f, 2.0f, 1.0f}, {1.0f, 1.0f, 1.4f}, 1.0f, 0.045f, 0.0075f});
 
     auto shadows_adapter =
-        [&](const ray3<float> &r_in, const std::vector<Sphere> &w_in, const std::vector<PointLight> &l_in, int)
+        [&](const ray3<float> &r_in, const std::vector<Sphere> &c_in, const std::vector<Sphere> &w_in, const std::vector<PointLight> &l_in, int)
     {
-        return color_for_ray_shadows(r_in, w_in, l_in);
+        return color_for_ray_shadows(r_in, c_in, w_in, l_in);
     };
-    render_scene("outputs/2_shadow.ppm", world_spheres, lights, shadows_adapter);
+    render_scene("outputs/2_shadow.ppm", world_spheres, lights, shadows_adapter, time_budget);
 
     std::vector<Sphere> world_spheres_rt = world_spheres;
 
@@ -453,12 +692,12 @@ int main()
     world_spheres_rt[0].material.albedo = {0.8f, 0.8f, 0.2f};
 
     auto trace_ray_adapter =
-        [&](const ray3<float> &r_in, const std::vector<Sphere> &w_in, const std::vector<PointLight> &l_in, int d)
+        [&](const ray3<float> &r_in, const std::vector<Sphere> &c_in, const std::vector<Sphere> &w_in, const std::vector<PointLight> &l_in, int d)
     {
-        return trace_ray(r_in, w_in, l_in, d);
+        return trace_ray(r_in, c_in, w_in, l_in, d);
     };
 
-    render_scene("outputs/3_reflection.ppm", world_spheres_rt, lights, trace_ray_adapter);
+    render_scene("outputs/3_reflection.ppm", world_spheres_rt, lights, trace_ray_adapter, time_budget);
 
     std::vector<Sphere> world_spheres_transmission = world_spheres_rt;
     world_spheres_transmission[1].material.albedo = {0.9f, 0.9f, 0.95f};
@@ -475,7 +714,7 @@ int main()
     world_spheres_transmission[3].material.diffuse_k = 0.1f;
     world_spheres_transmission[3].material.specular_k = 0.7f;
 
-    render_scene("outputs/4_transmission.ppm", world_spheres_transmission, lights, trace_ray_adapter);
+    render_scene("outputs/4_transmission.ppm", world_spheres_transmission, lights, trace_ray_adapter, time_budget);
 
     return 0;
 }
@@ -1,27 +1,180 @@
 #ifndef RENDER_HPP
 #define RENDER_HPP
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
 #include <cstdint>
 #include <cstdlib>
-#include <functional>
+#include <thread>
+#include <type_traits>
 #include <vector>
+#include "io.hpp"
+#include "vec3.hpp"
 
-template <typename T>
-using shader_t = std::function<void(uint32_t, uint32_t, T &, const std::vector<T> &)>;
+const uint32_t RASTER_TILE_SIZE = 64;
 
-template <typename T>
+// Runs `shader(x, y, datum)` on every pixel of `data`. The image is cut into
+// square tiles that worker threads claim one at a time, so each thread sweeps
+// a compact block of memory. Other threads write the rest of `data` meanwhile,
+// so a shader must touch only its own `datum`.
+template <typename T, typename Shader>
 std::vector<T> &rasterize(
     const uint32_t width,
     std::vector<T> &data,
-    const shader_t<T>& shader)
+    const Shader &shader)
 {
-    uint32_t index = 0;
-    for (auto& datum : data)
+    if (width == 0 || data.empty())
     {
-        auto [y, x] = std::ldiv(index++, width);
-        shader(x, y, datum, data);
+        return data;
+    }
+    const uint32_t height = static_cast<uint32_t>((data.size() + width - 1) / width);
+    const uint32_t tiles_x = (width + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+    const uint32_t tiles_y = (height + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+    const uint32_t tile_count = tiles_x * tiles_y;
+
+    std::atomic<uint32_t> next_tile = 0;
+    auto worker = [&]()
+    {
+        for (uint32_t tile = next_tile++; tile < tile_count; tile = next_tile++)
+        {
+            auto [ty, tx] = std::ldiv(tile, tiles_x);
+            const uint32_t x0 = tx * RASTER_TILE_SIZE;
+            const uint32_t y0 = ty * RASTER_TILE_SIZE;
+            const uint32_t x1 = std::min(x0 + RASTER_TILE_SIZE, width);
+            const uint32_t y1 = std::min(y0 + RASTER_TILE_SIZE, height);
+            for (uint32_t y = y0; y < y1; ++y)
+            {
+                for (uint32_t x = x0; x < x1; ++x)
+                {
+                    const size_t index = static_cast<size_t>(y) * width + x;
+                    if (index < data.size())
+                    {
+                        shader(x, y, data[index]);
+                    }
+                }
+            }
+        }
+    };
+
+    const uint32_t thread_count = std::clamp(std::thread::hardware_concurrency(), 1u, tile_count);
+    std::vector<std::thread> threads;
+    threads.reserve(thread_count - 1);
+    for (uint32_t i = 1; i < thread_count; ++i)
+    {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto &thread : threads)
+    {
+        thread.join();
     }
     return data;
 }
 
+// Divides an accumulated color by its sample count.
+struct normalize_samples
+{
+    float samples;
+
+    inline vec3<float> operator()(const vec3<float> &color) const { return color / samples; }
+};
+
+// Divides an accumulated color by the number of samples its own pixel took.
+struct normalize_sample_counts
+{
+    const std::vector<uint32_t> &counts;
+
+    inline vec3<float> operator()(const vec3<float> &color, size_t index) const
+    {
+        return color / static_cast<float>(std::max(counts[index], 1u));
+    }
+};
+
+// Scales linear radiance before quantization.
+struct expose
+{
+    float exposure;
+
+    inline vec3<float> operator()(const vec3<float> &color) const { return color * exposure; }
+};
+
+// Maps [0, 1] linearly onto [0, 255].
+struct quantize_linear
+{
+    inline vec3<uint8_t> operator()(const vec3<float> &color) const
+    {
+        return convert_vec3_float_to_uint8_once(color, 0.0f, 1.0f);
+    }
+};
+
+// Encodes linear [0, 1] with the sRGB transfer curve through a lookup table,
+// so the per-pixel cost is a clamp and three loads instead of three `pow`s.
+struct quantize_srgb
+{
+    static constexpr uint32_t LUT_SIZE = 1 << 14;
+    std::array<uint8_t, LUT_SIZE> lut;
+
+    quantize_srgb()
+    {
+        for (uint32_t i = 0; i < LUT_SIZE; ++i)
+        {
+            float linear = static_cast<float>(i) / (LUT_SIZE - 1);
+            float encoded = linear <= 0.0031308f
+                                ? linear * 12.92f
+                                : 1.055f * std::pow(linear, 1.0f / 2.4f) - 0.055f;
+            lut[i] = static_cast<uint8_t>(std::clamp(encoded * 255.0f + 0.5f, 0.0f, 255.0f));
+        }
+    }
+
+    inline uint8_t encode(float linear) const
+    {
+        float scaled = std::clamp(linear, 0.0f, 1.0f) * (LUT_SIZE - 1) + 0.5f;
+        return lut[static_cast<uint32_t>(scaled)];
+    }
+
+    inline vec3<uint8_t> operator()(const vec3<float> &color) const
+    {
+        return {encode(color.r()), encode(color.g()), encode(color.b())};
+    }
+};
+
+// Passes take either the color alone or the color and its pixel index.
+template <typename Pass>
+inline vec3<float> apply_pass(const Pass &pass, const vec3<float> &color, size_t index)
+{
+    if constexpr (std::is_invocable_v<const Pass &, const vec3<float> &, size_t>)
+    {
+        return pass(color, index);
+    }
+    else
+    {
+        return pass(color);
+    }
+}
+
+// Fuses `passes` and `quantize` into a single parallel sweep from the float
+// framebuffer `src` into the packed output `dst`.
+template <typename Quantizer, typename... Passes>
+std::vector<vec3<uint8_t>> &post_process(
+    const uint32_t width,
+    const std::vector<vec3<float>> &src,
+    std::vector<vec3<uint8_t>> &dst,
+    const Quantizer &quantize,
+    const Passes &...passes)
+{
+    dst.resize(src.size());
+    return rasterize(
+        width,
+        dst,
+        [&](uint32_t x, uint32_t y, vec3<uint8_t> &datum)
+        {
+            const size_t index = static_cast<size_t>(y) * width + x;
+            vec3<float> color = src[index];
+            ((color = apply_pass(passes, color, index)), ...);
+            datum = quantize(color);
+        });
+}
+
 #endif // RENDER_HPP